@@ -0,0 +1,27 @@
+#ifndef BLINKLIB_H_
+#define BLINKLIB_H_
+
+// Stand-in for the custom blinklib used only by the footprint benchmark. It
+// declares just the API used by the broadcast library so its objects can be
+// built and measured without the real platform. Nothing here is ever linked.
+
+#include <stdint.h>
+
+#define BGA_CUSTOM_BLINKLIB
+
+typedef uint8_t byte;
+
+#define FACE_COUNT 6
+#define IR_DATAGRAM_LEN 16
+
+#define FOREACH_FACE(x) for (byte x = 0; x < FACE_COUNT; ++x)
+
+bool isValueReceivedOnFaceExpired(byte face);
+
+byte getDatagramLengthOnFace(byte face);
+const byte *getDatagramOnFace(byte face);
+void markDatagramReadOnFace(byte face);
+bool isDatagramPendingOnFace(byte face);
+bool sendDatagramOnFace(const void *data, byte len, byte face);
+
+#endif  // BLINKLIB_H_
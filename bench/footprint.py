@@ -0,0 +1,317 @@
+#!/usr/bin/env python3
+"""Flash/RAM footprint and cycle budget benchmark for the broadcast library.
+
+Builds manager.cpp, message.cpp and message_tracker.cpp against the stand-in
+blinklib in bench/blinklib under every combination of the configuration
+macros in CONFIG_MATRIX and writes, for each combination, a JSON report with:
+
+* text, data and bss (and rodata, which lives in RAM on AVR) per symbol.
+* Stack frame and instruction count per function.
+* Every static call path starting at a global function (Process(), Send(),
+  etc) with its accumulated stack depth and instruction count, plus the worst
+  case for each root.
+
+Instruction counts are static (straight-line count of each function on the
+path, loops not unrolled), so they are an upper bound on code executed per
+call and a proxy for the cycle budget, not an exact cycle count. Calls into
+blinklib and libc are listed as externals and do not contribute to the stack
+or instruction totals.
+
+The default toolchain is avr-gcc targeting the Blinks MCU. Use --toolchain and
+--mcu to override it (for example, "--toolchain= --mcu=" uses the host
+compiler, which is only useful to smoke test this script).
+
+Usage:
+  bench/footprint.py [-o bench/baseline.json] [--compare old.json]
+"""
+
+import argparse
+import itertools
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCES = ["manager.cpp", "message.cpp", "message_tracker.cpp"]
+
+# Each entry is a macro and the (label, value) pairs it can take. A None value
+# means the macro is not defined (so the library default is used) and its label
+# is not part of the configuration name. BROADCAST_ENABLE_MESSAGE_HANDLER is
+# not included as no source references it (it would only duplicate configs).
+#
+# The "inline" alternative to BROADCAST_NOINLINE forces inlining, as just
+# dropping noinline lets GCC keep the functions out of line anyway at -Os. It
+# is always_inline without the inline keyword so Send() is still emitted. Note
+# that Send() is never called inside the library, so its attribute only matters
+# with LTO (which this benchmark does not use) and this axis effectively
+# measures maybe_broadcast().
+CONFIG_MATRIX = [
+    ("BROADCAST_DISABLE_REPLIES", [(None, None), ("disable_replies", "")]),
+    ("BROADCAST_NOINLINE",
+     [(None, None), ("inline", "__attribute__((always_inline))")]),
+    ("BROADCAST_MESSAGE_PAYLOAD_BYTES", [(None, None), ("payload=4", "4")]),
+]
+
+# Flags matching the Arduino AVR core build (minus LTO, which would prevent
+# per-symbol attribution).
+CXXFLAGS = [
+    "-Os", "-g", "-std=gnu++11", "-fno-exceptions", "-fno-threadsafe-statics",
+    "-ffunction-sections", "-fdata-sections", "-fstack-usage",
+]
+
+# Bytes pushed by a call instruction (the return address).
+AVR_CALL_BYTES = 2
+
+SECTIONS = {"t": "text", "d": "data", "b": "bss", "r": "rodata"}
+
+
+def run(cmd, cwd=None):
+  return subprocess.run(cmd, cwd=cwd, check=True, stdout=subprocess.PIPE,
+                        universal_newlines=True).stdout
+
+
+def config_name(choices):
+  return "+".join(label for label, _ in choices if label) or "default"
+
+
+def demangle(tools, names):
+  if not names:
+    return {}
+  out = run([tools["c++filt"]] + names).splitlines()
+  return dict(zip(names, out))
+
+
+def read_symbols(tools, obj):
+  """Returns {mangled: {section, size, line}} and the set of undefined names."""
+  symbols = {}
+  undefined = set()
+  for line in run([tools["nm"], "-S", "-l", obj]).splitlines():
+    fields = line.split()
+    if len(fields) >= 2 and fields[0] == "U":
+      undefined.add(fields[1])
+      continue
+    if len(fields) < 4:
+      continue
+    kind = fields[2].lower()
+    if kind not in SECTIONS:
+      continue
+    location = fields[4] if len(fields) > 4 else ""
+    symbols[fields[3]] = {
+        "section": SECTIONS[kind],
+        "size": int(fields[1], 16),
+        "global": fields[2].isupper(),
+        "location": os.path.basename(location),
+    }
+  return symbols, undefined
+
+
+def read_stack_usage(su_file):
+  """Returns {"file:line": bytes} from a -fstack-usage output file."""
+  usage = {}
+  with open(su_file) as f:
+    for line in f:
+      location, size, _ = line.rstrip("\n").split("\t")
+      path, lineno = location.split(":")[:2]
+      usage["%s:%s" % (os.path.basename(path), lineno)] = int(size)
+  return usage
+
+
+def read_disassembly(tools, obj):
+  """Returns {mangled: (instruction count, [callee mangled names])}."""
+  functions = {}
+  current = None
+  header = re.compile(r"^[0-9a-f]+ <(.+)>:$")
+  insn = re.compile(r"^\s+[0-9a-f]+:\t\S")
+  reloc = re.compile(r"^\s+[0-9a-f]+: R_\S+\s+(\S+?)(?:[-+]0x[0-9a-f]+)?$")
+  for line in run([tools["objdump"], "-dr", "--no-show-raw-insn",
+                   obj]).splitlines():
+    m = header.match(line)
+    if m:
+      current = m.group(1)
+      functions[current] = [0, []]
+      continue
+    if current is None:
+      continue
+    m = reloc.match(line)
+    if m:
+      target = m.group(1)
+      if target.startswith(".text."):
+        target = target[len(".text."):]
+      functions[current][1].append(target)
+    elif insn.match(line):
+      functions[current][0] += 1
+  return functions
+
+
+def build(tools, defines, build_dir):
+  flags = ["-I", os.path.join(ROOT, "bench", "blinklib"), "-I", ROOT]
+  flags += tools["mcu_flags"]
+  for macro, value in defines:
+    if value is not None:
+      flags.append("-D%s=%s" % (macro, value))
+  # always_inline on a function not declared inline warns it "might not be
+  # inlinable" (see CONFIG_MATRIX).
+  flags.append("-Wno-attributes")
+
+  objects = []
+  for source in SOURCES:
+    obj = os.path.join(build_dir, source.replace(".cpp", ".o"))
+    run([tools["c++"]] + CXXFLAGS + flags +
+        ["-c", os.path.join(ROOT, source), "-o", obj], cwd=build_dir)
+    objects.append(obj)
+  return objects
+
+
+def measure(tools, defines):
+  with tempfile.TemporaryDirectory() as build_dir:
+    objects = build(tools, defines, build_dir)
+
+    symbols = {}
+    undefined = set()
+    stack = {}
+    disassembly = {}
+    for obj in objects:
+      s, u = read_symbols(tools, obj)
+      symbols.update(s)
+      undefined |= u
+      stack.update(read_stack_usage(obj[:-2] + ".su"))
+      disassembly.update(read_disassembly(tools, obj))
+
+  names = demangle(tools, sorted(set(symbols) | undefined))
+
+  functions = {}
+  for mangled, info in symbols.items():
+    if info["section"] != "text" or mangled not in disassembly:
+      continue
+    count, targets = disassembly[mangled]
+    callees = []
+    for target in targets:
+      if (target in symbols and symbols[target]["section"] == "text") or \
+          target in undefined:
+        if target not in callees:
+          callees.append(target)
+    functions[mangled] = {
+        "instructions": count,
+        "stack": stack.get(info["location"]),
+        "calls": callees,
+    }
+
+  def walk(mangled, visited):
+    """Yields (path, stack, instructions, externals) for every call path."""
+    function = functions[mangled]
+    frame = (function["stack"] or 0) + tools["call_bytes"]
+    internal = [c for c in function["calls"]
+                if c in functions and c not in visited]
+    externals = [names[c] for c in function["calls"] if c not in functions]
+    if not internal:
+      yield [names[mangled]], frame, function["instructions"], sorted(externals)
+      return
+    for callee in internal:
+      for path, depth, count, ext in walk(callee, visited | {callee}):
+        yield ([names[mangled]] + path, frame + depth,
+               function["instructions"] + count, sorted(set(externals + ext)))
+
+  paths = {}
+  for mangled, info in sorted(symbols.items()):
+    if not info["global"] or mangled not in functions:
+      continue
+    root_paths = [{"path": p, "stack": s, "instructions": i, "externals": e}
+                  for p, s, i, e in walk(mangled, {mangled})]
+    paths[names[mangled]] = {
+        "worst_stack": max(p["stack"] for p in root_paths),
+        "worst_instructions": max(p["instructions"] for p in root_paths),
+        "paths": root_paths,
+    }
+
+  totals = {section: 0 for section in SECTIONS.values()}
+  for info in symbols.values():
+    totals[info["section"]] += info["size"]
+
+  return {
+      "defines": {m: v for m, v in defines if v is not None},
+      "totals": totals,
+      "symbols": {names[m]: {"section": i["section"], "size": i["size"]}
+                  for m, i in sorted(symbols.items())},
+      "functions": {names[m]: {"instructions": f["instructions"],
+                               "stack": f["stack"],
+                               "calls": [names[c] for c in f["calls"]]}
+                    for m, f in sorted(functions.items())},
+      "paths": paths,
+  }
+
+
+def compare(old, new):
+  """Prints total and worst case path deltas between two reports."""
+  for key in ("toolchain", "mcu"):
+    if old.get(key) != new[key]:
+      print("warning: %s differs (%r vs %r), deltas are not meaningful" %
+            (key, old.get(key), new[key]))
+  for name, config in sorted(new["configs"].items()):
+    previous = old.get("configs", {}).get(name)
+    if previous is None:
+      print("%s: new configuration" % name)
+      continue
+    deltas = []
+    for section, size in sorted(config["totals"].items()):
+      delta = size - previous["totals"].get(section, 0)
+      if delta:
+        deltas.append("%s %+d" % (section, delta))
+    for root, info in sorted(config["paths"].items()):
+      before = previous["paths"].get(root)
+      if before is None:
+        continue
+      for key in ("worst_stack", "worst_instructions"):
+        delta = info[key] - before[key]
+        if delta:
+          deltas.append("%s %s %+d" % (root, key, delta))
+    print("%s: %s" % (name, ", ".join(deltas) or "unchanged"))
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("-o", "--output",
+                      default=os.path.join(ROOT, "bench", "baseline.json"),
+                      help="report file to write (- for stdout)")
+  parser.add_argument("--compare", help="previous report to compare against")
+  parser.add_argument("--toolchain", default="avr-",
+                      help="toolchain prefix (default: avr-)")
+  parser.add_argument("--mcu", default="atmega168pb",
+                      help="target MCU, empty for none (default: atmega168pb)")
+  args = parser.parse_args()
+
+  tools = {t: args.toolchain + t for t in ("c++", "nm", "objdump", "c++filt")}
+  tools["mcu_flags"] = ["-mmcu=" + args.mcu] if args.mcu else []
+  tools["call_bytes"] = AVR_CALL_BYTES if args.mcu else 0
+
+  try:
+    version = run([tools["c++"], "--version"]).splitlines()[0]
+  except FileNotFoundError:
+    sys.exit("%s not found. Install it or use --toolchain." % tools["c++"])
+
+  report = {
+      "toolchain": version,
+      "mcu": args.mcu,
+      "cxxflags": CXXFLAGS,
+      "configs": {},
+  }
+  for choices in itertools.product(*(v for _, v in CONFIG_MATRIX)):
+    defines = [(m, value) for (m, _), (_, value) in zip(CONFIG_MATRIX, choices)]
+    report["configs"][config_name(choices)] = measure(tools, defines)
+
+  if args.compare:
+    with open(args.compare) as f:
+      compare(json.load(f), report)
+
+  output = json.dumps(report, indent=2, sort_keys=True) + "\n"
+  if args.output == "-":
+    sys.stdout.write(output)
+  else:
+    with open(args.output, "w") as f:
+      f.write(output)
+
+
+if __name__ == "__main__":
+  main()
@@ -18,27 +18,32 @@
 
 // Prototype for functions that want to handle external messages. These are
 // messages that are not tracked or directly processed by the broadcast message
-// handler (they will be processed by the external message handler).
+// handler (they will be processed by the external message handler). The
+// payload_len parameter is the actual size of the received payload.
 // Implementations should return true if the message was processed by it and
 // false otherwise.
 //
-// bool external_message_handler(byte face, const Message* message);
+// bool external_message_handler(byte face, const Message* message,
+//      byte payload_len);
 //
 // #define BROADCAST_EXTERNAL_MESSAGE_HANDLER external_message_handler
 
 // Prototype for functions that want to change the payload of a message as soon
 // as it reaches a Blink. It is always called once per message that arrives and
-// any changes in the payload will be seen by upstream Blinks (unless modified
-// by a ForwardMessageHandler. See below). The message_id parameter can be used
-// to differentiate between messages so specific code can be executed. The
-// src_face parameter is the face the message arrived on. If the loop parameter
+// any changes to the first payload_len bytes of the payload will be seen by
+// upstream Blinks (unless modified by a ForwardMessageHandler. See below).
+// Changes at or past payload_len are not sent as this handler can not grow the
+// message (a ForwardMessageHandler has to do it). The message_id parameter can
+// be used to differentiate between messages so specific code can be executed.
+// The src_face parameter is the face the message arrived on. The payload_len
+// parameter is the actual size of the received payload. If the loop parameter
 // is true, this means that this handler was called because a message that
-// caused a loop was received. In this case, payload will be nullptr and any
-// actions should be based only on message_id and src_face. This is also called
-// for fire-and-forget messages.
+// caused a loop was received. In this case, payload will be nullptr,
+// payload_len will be 0 and any actions should be based only on message_id and
+// src_face. This is also called for fire-and-forget messages.
 //
 // void rcv_message_handler(byte message_id, byte src_face, byte *payload,
-//      bool loop);
+//      byte payload_len, bool loop);
 //
 //#define BROADCAST_RCV_MESSAGE_HANDLER rcv_message_handler
 
@@ -52,12 +57,16 @@
 // routing information. The message_id parameter can be used to differentiate
 // between messages so specific code can be executed. the src_face and dst_face
 // are, respectively, the face the message arrived from and the face it is being
-// forwarded to. This is also called for fire-and-forget messages.
-// Implementations should return the actual message payload size (which might be
-// smaller than MESSAGE_PAYLOAD_BYTES).
+// forwarded to. The payload_len parameter is the actual size of the received
+// payload. This is also called for fire-and-forget messages. Implementations
+// should return the actual message payload size (which might be smaller than
+// MESSAGE_PAYLOAD_BYTES). Returning payload_len forwards the message with its
+// original size and returning anything bigger also sends the payload bytes
+// past it (which hold whatever was in the received buffer unless set by the
+// handler).
 //
 // byte fwd_message_handler(byte message_id, byte src_face, byte dst_face, byte
-//      *payload);
+//      *payload, byte payload_len);
 //
 //#define BROADCAST_FWD_MESSAGE_HANDLER fwd_message_handler
 
@@ -65,10 +74,12 @@
 // it reaches a Blink. It is always called once per reply and as there are
 // possibly multiple replies arriving, payload is read-only. The message_id
 // parameter can be used to differentiate between messages so specific code can
-// be executed. The src_face parameter is the face the reply arrived on. This is
-// never called for fire-and-forget messages.
+// be executed. The src_face parameter is the face the reply arrived on. The
+// payload_len parameter is the actual size of the received reply payload. This
+// is never called for fire-and-forget messages.
 //
-// void rcv_reply_handler(byte message_id, byte src_face, const byte *payload);
+// void rcv_reply_handler(byte message_id, byte src_face, const byte *payload,
+//      byte payload_len);
 //
 //#define BROADCAST_RCV_REPLY_HANDLER rcv_reply_handler
 
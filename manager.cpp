@@ -33,46 +33,57 @@
 #define BROADCAST_FWD_REPLY_HANDLER default_fwd_reply_handler
 #endif
 
+// Functions that are kept out of line because it saves storage space. This can
+// be overridden (for example, with an empty definition) to measure the impact.
+#ifndef BROADCAST_NOINLINE
+#define BROADCAST_NOINLINE __attribute__((noinline))
+#endif
+
 namespace broadcast {
 
 namespace manager {
 
 static bool __attribute__((unused))
-default_external_message_handler(byte face, const Message *message) {
+default_external_message_handler(byte face, const Message *message,
+                                 byte payload_len) {
   // Default external message handler simply returns false to indicate it did
   // not process the message.
   (void)face;
   (void)message;
+  (void)payload_len;
   return false;
 }
 
 static void __attribute__((unused))
 default_rcv_message_handler(byte message_id, byte src_face, byte *payload,
-                            bool loop) {
+                            byte payload_len, bool loop) {
   // Default receive message handler does nothing.
   (void)message_id;
   (void)src_face;
   (void)payload;
+  (void)payload_len;
   (void)loop;
 }
 
 static byte __attribute__((unused))
 default_fwd_message_handler(byte message_id, byte src_face, byte dst_face,
-                            byte *payload) {
-  // Default forward message handler simply returns the configured payload size.
+                            byte *payload, byte payload_len) {
+  // Default forward message handler simply returns the received payload size.
   (void)message_id;
   (void)src_face;
   (void)dst_face;
   (void)payload;
-  return BROADCAST_MESSAGE_PAYLOAD_BYTES;
+  return payload_len;
 }
 
 static void __attribute__((unused))
-default_rcv_reply_handler(byte message_id, byte src_face, const byte *payload) {
+default_rcv_reply_handler(byte message_id, byte src_face, const byte *payload,
+                          byte payload_len) {
   // Default receive reply handler does nothing.
   (void)message_id;
   (void)src_face;
   (void)payload;
+  (void)payload_len;
 }
 
 static byte __attribute__((unused))
@@ -89,6 +100,7 @@ static byte parent_face_ = FACE_COUNT;
 static byte sent_faces_;
 
 static Message *result_;
+static byte result_payload_len_;
 
 // Return true if we generated a result (as opposed to not doing anything or
 // forwarding a reply back to the parent).
@@ -116,11 +128,19 @@ static void maybe_fwd_reply_or_set_result(Message *message) {
     // This is fine though as a result is only supposed to be valid in the
     // same loop() iteration it was generated.
     result_ = message;
+
+    // Clamp the length to what we can handle as Receive() copies that many
+    // bytes into a caller provided message.
+    if (len > BROADCAST_MESSAGE_PAYLOAD_BYTES) {
+      len = BROADCAST_MESSAGE_PAYLOAD_BYTES;
+    }
+    result_payload_len_ = len;
   }
 }
 #endif
 
-static void broadcast_message(byte src_face, broadcast::Message *message) {
+static void broadcast_message(byte src_face, broadcast::Message *message,
+                              byte payload_len) {
   // Broadcast message to all connected blinks (except the parent one).
 
 #ifndef BROADCAST_DISABLE_REPLIES
@@ -145,11 +165,15 @@ static void broadcast_message(byte src_face, broadcast::Message *message) {
       continue;
     }
 
+    // Copy the full message. The source is always full-size (the receive
+    // buffer or the caller's message in Send()) and a single fixed-size copy
+    // is smaller than copying only the bytes in use and clearing the rest. Only
+    // the bytes in use are actually sent (see below).
     broadcast::Message fwd_message;
     memcpy(&fwd_message, message, BROADCAST_MESSAGE_DATA_BYTES);
 
     byte len = BROADCAST_FWD_MESSAGE_HANDLER(fwd_message.header.id, src_face, f,
-                                             fwd_message.payload);
+                                             fwd_message.payload, payload_len);
 
     // Should never fail.
     sendDatagramOnFace((const byte *)&fwd_message,
@@ -216,7 +240,7 @@ static bool would_broadcast_fail(byte src_face) {
 }
 
 #ifndef BROADCAST_DISABLE_REPLIES
-static bool handle_reply(byte face, Message *reply) {
+static bool handle_reply(byte face, Message *reply, byte payload_len) {
   if (would_forward_reply_and_fail(face)) {
     // Do not even try processing this message.
     return false;
@@ -224,7 +248,8 @@ static bool handle_reply(byte face, Message *reply) {
 
   // Note the call above already cleared the sent_faces_ bit for face.
 
-  BROADCAST_RCV_REPLY_HANDLER(reply->header.id, face, reply->payload);
+  BROADCAST_RCV_REPLY_HANDLER(reply->header.id, face, reply->payload,
+                              payload_len);
 
   maybe_fwd_reply_or_set_result(reply);
 
@@ -232,8 +257,8 @@ static bool handle_reply(byte face, Message *reply) {
 }
 #endif
 
-static bool __attribute__((noinline))
-maybe_broadcast(byte face, Message *message) {
+static bool BROADCAST_NOINLINE
+maybe_broadcast(byte face, Message *message, byte payload_len) {
   if (would_broadcast_fail(face)) {
     // Do not try to process this message and broadcast it. Note that this might
     // prevent us from making progress and creating a deadlock but there is only
@@ -246,16 +271,16 @@ maybe_broadcast(byte face, Message *message) {
 
   if (face != FACE_COUNT) {
     BROADCAST_RCV_MESSAGE_HANDLER(message->header.id, face, message->payload,
-                                  false);
+                                  payload_len, false);
   }
 
   // Broadcast message.
-  broadcast_message(face, message);
+  broadcast_message(face, message, payload_len);
 
   return true;
 }
 
-static bool handle_message(byte face, Message *message) {
+static bool handle_message(byte face, Message *message, byte payload_len) {
   if (message::tracker::Tracked(message->header)) {
 #ifndef BROADCAST_DISABLE_REPLIES
     if (!message->header.is_fire_and_forget) {
@@ -275,9 +300,9 @@ static bool handle_message(byte face, Message *message) {
 #endif
 
     // Call receive message handler to process loop.
-    BROADCAST_RCV_MESSAGE_HANDLER(message->header.id, face, nullptr, true);
+    BROADCAST_RCV_MESSAGE_HANDLER(message->header.id, face, nullptr, 0, true);
   } else {
-    if (!maybe_broadcast(face, message)) return false;
+    if (!maybe_broadcast(face, message, payload_len)) return false;
   }
 
 #ifndef BROADCAST_DISABLE_REPLIES
@@ -308,17 +333,26 @@ void Process() {
   // Ideally we would have enought memory for a message queue, but we do not
   // have this luxury.
   FOREACH_FACE(face) {
-    if (getDatagramLengthOnFace(face) == 0) {
+    byte len = getDatagramLengthOnFace(face);
+    if (len == 0) {
       // No datagram waiting on this face. Move to the next one.
       continue;
     }
 
+    // Clamp the length to what we can handle. A datagram bigger than our
+    // configured message size (say, from a Blink with a different
+    // configuration) would otherwise overflow the local forward buffer.
+    if (len > BROADCAST_MESSAGE_DATA_BYTES) len = BROADCAST_MESSAGE_DATA_BYTES;
+
+    byte payload_len = len - BROADCAST_MESSAGE_HEADER_BYTES;
+
     // Get a pointer to the available data. Notice this does not actually
     // consume it. We will do it when we are sure it has been handled. We
     // cheat a bit and cast directly to a message. Note that the payload on
-    // the message we received might be smaller than MESSAGE_PAYLOAD_SIZE. but
-    // this does not matter because the underlying receive buffer will always
-    // be big enough so no illegal memory access should happen.
+    // the message we received might be smaller than MESSAGE_PAYLOAD_SIZE
+    // (payload_len above is the actual size) but the underlying receive
+    // buffer will always be big enough so no illegal memory access should
+    // happen even if something reads past it.
     broadcast::Message *message = (broadcast::Message *)getDatagramOnFace(face);
 
     bool message_consumed = false;
@@ -331,12 +365,13 @@ void Process() {
     // consume it.
 #ifndef BROADCAST_DISABLE_REPLIES
     if (message->header.is_reply) {
-      message_consumed = handle_reply(face, message);
+      message_consumed = handle_reply(face, message, payload_len);
     } else {
 #endif  // BROADCAST_DISABLE_REPLIES
-      message_consumed = BROADCAST_EXTERNAL_MESSAGE_HANDLER(face, message);
+      message_consumed =
+          BROADCAST_EXTERNAL_MESSAGE_HANDLER(face, message, payload_len);
       if (!message_consumed) {
-        message_consumed = handle_message(face, message);
+        message_consumed = handle_message(face, message, payload_len);
       }
 #ifndef BROADCAST_DISABLE_REPLIES
     }
@@ -348,19 +383,31 @@ void Process() {
   }
 }
 
-bool __attribute__((noinline)) Send(broadcast::Message *message) {
+bool BROADCAST_NOINLINE
+Send(broadcast::Message *message, byte payload_len) {
+  // Clamp the length to what we can handle, same as for received messages.
+  // Anything bigger would overflow the local forward buffer.
+  if (payload_len > BROADCAST_MESSAGE_PAYLOAD_BYTES) {
+    payload_len = BROADCAST_MESSAGE_PAYLOAD_BYTES;
+  }
+
   // Setup tracking for this message.
   message->header.sequence = message::tracker::NextSequence();
 
-  return maybe_broadcast(FACE_COUNT, message);
+  return maybe_broadcast(FACE_COUNT, message, payload_len);
 }
 
 #ifndef BROADCAST_DISABLE_REPLIES
-bool Receive(broadcast::Message *reply) {
+bool Receive(broadcast::Message *reply, byte *payload_len) {
   if (result_ == nullptr) return false;
 
   if (reply != nullptr) {
-    memcpy(reply, result_, BROADCAST_MESSAGE_DATA_BYTES);
+    memcpy(reply, result_,
+           result_payload_len_ + BROADCAST_MESSAGE_HEADER_BYTES);
+  }
+
+  if (payload_len != nullptr) {
+    *payload_len = result_payload_len_;
   }
 
   return true;
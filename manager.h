@@ -12,16 +12,19 @@ namespace manager {
 void Process();
 
 // Sends the given message to all connected Blinks so it can be propagated
-// through the network. Returns true if the message was sent and false
-// otherwise.
-bool Send(broadcast::Message *message);
+// through the network. Only the first payload_len bytes of the payload are
+// sent (payload_len is clamped to BROADCAST_MESSAGE_PAYLOAD_BYTES). Returns true
+// if the message was sent and false otherwise.
+bool Send(broadcast::Message *message,
+          byte payload_len = BROADCAST_MESSAGE_PAYLOAD_BYTES);
 
 #ifndef BROADCAST_DISABLE_REPLIES
 // Tries to receive the result of a sent message. This will only ever return
 // true at the same Blink that sent the message. Returns true if a result was
-// available and false otherwise. Note that this will never return true for
-// fire-and-forget messages.
-bool Receive(broadcast::Message *result);
+// available and false otherwise. Only the bytes in use are copied to result
+// and, if payload_len is not nullptr, the result payload length is stored in
+// it. Note that this will never return true for fire-and-forget messages.
+bool Receive(broadcast::Message *result, byte *payload_len = nullptr);
 
 // Returns true if we are still waiting for replies for a message in progress.
 // This can be used to prevent other messages being sent before we complete the